@@ -0,0 +1,133 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Immutable set of strings kept in one flat open-addressing table with linear probing. The table
+// is at most half full, so a lookup is a hash and one or two comparisons of string lengths.
+// An empty view marks a free slot, hence the set never contains the empty string.
+
+constexpr uint64_t HashString(std::string_view text) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : text) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+constexpr size_t ComputeFlatStringTableCapacity(size_t string_count) {
+    return std::bit_ceil(string_count * 2 + 1);
+}
+
+constexpr void InsertIntoFlatStringTable(std::span<std::string_view> slots, std::string_view text) {
+    const size_t mask = slots.size() - 1;
+    for (size_t slot = HashString(text) & mask;; slot = (slot + 1) & mask) {
+        if (slots[slot].empty()) {
+            slots[slot] = text;
+            return;
+        }
+        if (slots[slot] == text) {
+            return;
+        }
+    }
+}
+
+template <size_t Capacity>
+struct FlatStringTable {
+    std::array<std::string_view, Capacity> slots{};
+};
+
+// Builds the table at compile time when used in a constant expression, e.g.
+//     static constexpr auto STOP_WORDS = MakeFlatStringTable<3>({ "a"sv, "in"sv, "the"sv });
+// Empty strings are skipped.
+template <size_t N>
+constexpr auto MakeFlatStringTable(const std::array<std::string_view, N>& strings) {
+    FlatStringTable<ComputeFlatStringTableCapacity(N)> table;
+    for (const std::string_view text : strings) {
+        if (!text.empty()) {
+            InsertIntoFlatStringTable(table.slots, text);
+        }
+    }
+    return table;
+}
+
+class FlatStringSet {
+public:
+    // Copies the strings into storage owned by the set.
+    template <typename StringContainer>
+    explicit FlatStringSet(const StringContainer& strings);
+
+    // Refers to the table without copying it, so the table must outlive the set. A temporary table
+    // would not, hence the deleted overload.
+    template <size_t Capacity>
+    explicit FlatStringSet(const FlatStringTable<Capacity>& table);
+    template <size_t Capacity>
+    explicit FlatStringSet(const FlatStringTable<Capacity>&& table) = delete;
+
+    FlatStringSet(const FlatStringSet&) = delete;
+    FlatStringSet& operator=(const FlatStringSet&) = delete;
+    FlatStringSet(FlatStringSet&&) = default;
+    FlatStringSet& operator=(FlatStringSet&&) = default;
+
+    bool Contains(std::string_view text) const;
+
+    std::span<const std::string_view> GetSlots() const;
+
+private:
+    std::vector<char> characters_;
+    std::vector<std::string_view> own_slots_;
+    std::span<const std::string_view> slots_;
+};
+
+template <typename StringContainer>
+FlatStringSet::FlatStringSet(const StringContainer& strings) {
+    size_t string_count = 0;
+    size_t character_count = 0;
+    for (const auto& text : strings) {
+        ++string_count;
+        character_count += std::string_view(text).size();
+    }
+    // A vector keeps its buffer on move, unlike a short string, so the views survive moving the set
+    characters_.reserve(character_count);
+    for (const auto& text : strings) {
+        const std::string_view view(text);
+        characters_.insert(characters_.end(), view.begin(), view.end());
+    }
+    own_slots_.resize(ComputeFlatStringTableCapacity(string_count));
+    size_t offset = 0;
+    for (const auto& text : strings) {
+        const size_t size = std::string_view(text).size();
+        if (size > 0) {
+            InsertIntoFlatStringTable(own_slots_, std::string_view(characters_.data() + offset, size));
+        }
+        offset += size;
+    }
+    slots_ = own_slots_;
+}
+
+template <size_t Capacity>
+FlatStringSet::FlatStringSet(const FlatStringTable<Capacity>& table)
+    : slots_(table.slots)
+{
+}
+
+inline bool FlatStringSet::Contains(std::string_view text) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = HashString(text) & mask;; slot = (slot + 1) & mask) {
+        if (slots_[slot].empty()) {
+            return false;
+        }
+        if (slots_[slot] == text) {
+            return true;
+        }
+    }
+}
+
+inline std::span<const std::string_view> FlatStringSet::GetSlots() const {
+    return slots_;
+}
@@ -5,10 +5,23 @@
 #include "paginator.h"
 #include "request_queue.h"
 #include "remove_duplicates.h"
+#include "test_example_functions.h"
 
 using namespace std;
 
-int main() {
+// "main test" runs the tests, "main benchmark" runs the tests and then the benchmarks
+int main(int argc, char* argv[]) {
+    const string_view mode = argc > 1 ? argv[1] : ""sv;
+    if (mode == "test"sv || mode == "benchmark"sv) {
+        TestSearchServer();
+        if (mode == "benchmark"sv) {
+            BenchmarkRemoveDocuments();
+            BenchmarkMemoryResources();
+            BenchmarkStopWordLookup();
+        }
+        return 0;
+    }
+
     SearchServer search_server("and with"s);
 
     search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
@@ -0,0 +1,116 @@
+#include "memory_resources.h"
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    thread_local vector<byte> scratch_buffer;
+    thread_local bool scratch_buffer_in_use = false;
+    thread_local vector<uint64_t> scratch_counters;
+    thread_local bool scratch_counters_in_use = false;
+}
+
+CountingMemoryResource::CountingMemoryResource(pmr::memory_resource* upstream)
+    : upstream_(upstream)
+{
+}
+
+AllocationStats CountingMemoryResource::GetStats() const {
+    return { allocation_count_.load(memory_order_relaxed), allocated_bytes_.load(memory_order_relaxed),
+        bytes_in_use_.load(memory_order_relaxed), peak_bytes_in_use_.load(memory_order_relaxed) };
+}
+
+void* CountingMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    void* pointer = upstream_->allocate(bytes, alignment);
+    allocation_count_.fetch_add(1, memory_order_relaxed);
+    allocated_bytes_.fetch_add(bytes, memory_order_relaxed);
+    const size_t bytes_in_use = bytes_in_use_.fetch_add(bytes, memory_order_relaxed) + bytes;
+    size_t peak = peak_bytes_in_use_.load(memory_order_relaxed);
+    while (peak < bytes_in_use && !peak_bytes_in_use_.compare_exchange_weak(peak, bytes_in_use, memory_order_relaxed)) {
+    }
+    return pointer;
+}
+
+void CountingMemoryResource::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    upstream_->deallocate(pointer, bytes, alignment);
+    bytes_in_use_.fetch_sub(bytes, memory_order_relaxed);
+}
+
+bool CountingMemoryResource::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+ScratchArena::ScratchArena(pmr::memory_resource* upstream)
+    : upstream_(upstream)
+{
+    pmr::memory_resource* overflow = this;
+    // a query started from inside another one (e.g. from a filter) must not reuse the busy buffer
+    if (scratch_buffer_in_use) {
+        arena_.emplace(overflow);
+        return;
+    }
+    if (scratch_buffer.empty()) {
+        scratch_buffer.resize(INITIAL_BUFFER_SIZE);
+    }
+    scratch_buffer_in_use = true;
+    owns_buffer_ = true;
+    arena_.emplace(scratch_buffer.data(), scratch_buffer.size(), overflow);
+}
+
+ScratchArena::~ScratchArena() {
+    arena_.reset();
+    if (owns_buffer_) {
+        if (overflow_bytes_ > 0) {
+            scratch_buffer.resize(min(scratch_buffer.size() + overflow_bytes_, max(scratch_buffer.size(), MAX_BUFFER_SIZE)));
+        }
+        scratch_buffer_in_use = false;
+    }
+}
+
+pmr::memory_resource* ScratchArena::Get() {
+    return &*arena_;
+}
+
+void* ScratchArena::do_allocate(size_t bytes, size_t alignment) {
+    overflow_bytes_ += bytes;
+    return upstream_->allocate(bytes, alignment);
+}
+
+void ScratchArena::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    upstream_->deallocate(pointer, bytes, alignment);
+}
+
+bool ScratchArena::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+ScratchCounters::ScratchCounters(size_t size, pmr::memory_resource* memory_resource)
+    : touched_indices_(memory_resource)
+{
+    // as with ScratchArena, a nested query gets counters of its own
+    if (scratch_counters_in_use) {
+        nested_counters_.resize(size);
+        counters_ = nested_counters_;
+        return;
+    }
+    if (scratch_counters.size() < size) {
+        scratch_counters.resize(size);
+    }
+    scratch_counters_in_use = true;
+    owns_counters_ = true;
+    counters_ = span<uint64_t>(scratch_counters).first(size);
+}
+
+ScratchCounters::~ScratchCounters() {
+    if (owns_counters_) {
+        for (const size_t index : touched_indices_) {
+            counters_[index] = 0;
+        }
+        scratch_counters_in_use = false;
+    }
+}
+
+span<size_t> ScratchCounters::GetTouchedIndices() {
+    return touched_indices_;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <vector>
+
+struct AllocationStats {
+    size_t allocation_count = 0;
+    size_t allocated_bytes = 0;
+    size_t bytes_in_use = 0;
+    size_t peak_bytes_in_use = 0;
+};
+
+class CountingMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit CountingMemoryResource(std::pmr::memory_resource* upstream);
+
+    AllocationStats GetStats() const;
+
+private:
+    std::pmr::memory_resource* upstream_;
+    std::atomic<size_t> allocation_count_ = 0;
+    std::atomic<size_t> allocated_bytes_ = 0;
+    std::atomic<size_t> bytes_in_use_ = 0;
+    std::atomic<size_t> peak_bytes_in_use_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// Scratch memory of a single query. The arena is carved out of a per-thread buffer which grows to
+// the largest query seen on that thread, so once warmed up the scratch structures of a query stop
+// going to the heap; parsing and the result still do. Everything allocated from the arena is
+// released at once when it goes out of scope.
+class ScratchArena : private std::pmr::memory_resource {
+public:
+    explicit ScratchArena(std::pmr::memory_resource* upstream);
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+    ~ScratchArena();
+
+    std::pmr::memory_resource* Get();
+
+private:
+    static constexpr size_t INITIAL_BUFFER_SIZE = 64 * 1024;
+    static constexpr size_t MAX_BUFFER_SIZE = 64 * 1024 * 1024;
+
+    std::pmr::memory_resource* upstream_;
+    bool owns_buffer_ = false;
+    size_t overflow_bytes_ = 0;
+    std::optional<std::pmr::monotonic_buffer_resource> arena_;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// Per-query counters indexed by document ordinal. They live in a per-thread array which stays zeroed
+// between queries: only the touched counters are cleared when the object goes out of scope, so a
+// query costs time proportional to the counters it touches rather than to the whole collection.
+class ScratchCounters {
+public:
+    ScratchCounters(size_t size, std::pmr::memory_resource* memory_resource);
+    ScratchCounters(const ScratchCounters&) = delete;
+    ScratchCounters& operator=(const ScratchCounters&) = delete;
+    ~ScratchCounters();
+
+    void Add(size_t index, uint64_t value);
+    uint64_t operator[](size_t index) const;
+    // Indices of the counters touched by Add in the order of their first touch.
+    std::span<size_t> GetTouchedIndices();
+
+private:
+    // marks a touched counter, so that adding zero still makes it touched
+    static constexpr uint64_t TOUCHED = uint64_t(1) << 63;
+
+    bool owns_counters_ = false;
+    std::vector<uint64_t> nested_counters_;
+    std::span<uint64_t> counters_;
+    std::pmr::vector<size_t> touched_indices_;
+};
+
+inline void ScratchCounters::Add(size_t index, uint64_t value) {
+    uint64_t& counter = counters_[index];
+    if (counter == 0) {
+        counter = TOUCHED;
+        touched_indices_.push_back(index);
+    }
+    counter += value;
+}
+
+inline uint64_t ScratchCounters::operator[](size_t index) const {
+    return counters_[index] & ~TOUCHED;
+}
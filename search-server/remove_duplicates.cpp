@@ -3,12 +3,15 @@
 using namespace std;
 
 void RemoveDuplicates(SearchServer& search_server) {
+	// the server iterates in insertion order, the document with the lowest id is the one to keep
+	vector<int> document_ids(search_server.begin(), search_server.end());
+	sort(document_ids.begin(), document_ids.end());
 	vector<int> duplicated_documents_ids;
 	set<set<string>> all_document_words;
-	for (const int document_id : search_server) {
+	for (const int document_id : document_ids) {
 		set<string> words_in_document;
 		for (const auto& [word, freq] : search_server.GetWordFrequencies(document_id)) {
-			words_in_document.insert(word);
+			words_in_document.insert(string(word));
 		}
 		if (all_document_words.contains(words_in_document)) {
 			cout << "Found duplicate document id "s << document_id << endl;
@@ -18,7 +21,5 @@ void RemoveDuplicates(SearchServer& search_server) {
 			all_document_words.insert(words_in_document);
 		}
 	}
-		for (int& id : duplicated_documents_ids) {
-			search_server.RemoveDocument(id);
-		}
+	search_server.RemoveDocuments(duplicated_documents_ids);
 }
@@ -4,42 +4,109 @@
 
 using namespace std;
 
-SearchServer::SearchServer(const string_view stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (abs(lhs.relevance - rhs.relevance) < ACCURACY) {
+        return lhs.rating > rhs.rating;
+    }
+    else {
+        return lhs.relevance > rhs.relevance;
+    }
+}
+
+SearchServer::SearchServer(const string_view stop_words_text, pmr::memory_resource* memory_resource)
+    : SearchServer(SplitIntoWords(stop_words_text), memory_resource)
 {
 }
 
-SearchServer::SearchServer(const string& stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))
+SearchServer::SearchServer(const string& stop_words_text, pmr::memory_resource* memory_resource)
+    : SearchServer(SplitIntoWords(stop_words_text), memory_resource)
 {
 }
 
 void SearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (document_id_to_ordinal_.count(document_id) > 0)) {
         throw invalid_argument("Invalid document_id"s);
     }
     const vector<string_view> words = SplitIntoWordsNoStop(document);
-    set<string> words_in_document;
+    vector<string_view> stored_words;
+    stored_words.reserve(words.size());
+    for (const string_view word : words) {
+        auto stored_word = words_.find(word);
+        if (stored_word == words_.end()) {
+            stored_word = words_.emplace(word).first;
+        }
+        stored_words.push_back(*stored_word);
+    }
+    sort(stored_words.begin(), stored_words.end());
+
+    const int ordinal = static_cast<int>(document_ids_.size());
     const double inv_word_count = 1.0 / words.size();
-    for (const string_view& word : words) {
-        words_in_document.insert(string(word));
-        document_to_word_freqs_[document_id][*(words_in_document.find(string(word)))] += inv_word_count;
-        word_to_document_freqs_[*(words_in_document.find(string(word)))][document_id] += inv_word_count;
+    for (auto first = stored_words.begin(); first != stored_words.end();) {
+        const auto last = upper_bound(first, stored_words.end(), *first);
+        const double term_freq = (last - first) * inv_word_count;
+        forward_index_.push_back({ *first, term_freq });
+        PostingList& posting_list = word_to_document_freqs_[*first];
+        posting_list.postings.push_back({ ordinal, term_freq });
+        posting_list.log_document_freq = log(posting_list.postings.size());
+        InvalidateExcludedDocuments(*first);
+        first = last;
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, move(words_in_document) });
-    document_ids_.insert(document_id);
+    forward_index_offsets_.push_back(forward_index_.size());
+    document_ids_.push_back(document_id);
+    document_ratings_.push_back(ComputeAverageRating(ratings));
+    document_statuses_.push_back(status);
+    document_id_to_ordinal_.emplace(document_id, ordinal);
+    log_document_count_ = log(GetDocumentCount());
+    has_impact_scores_ = false;
 }
 
 int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(documents_.size());
+    return static_cast<int>(document_id_to_ordinal_.size());
 }
 
 SearchServer::it SearchServer::begin() {
-    return document_ids_.begin();
+    return DocumentIdIterator(document_ids_.begin(), document_ids_.end());
 }
 
 SearchServer::it SearchServer::end() {
-    return document_ids_.end();
+    return DocumentIdIterator(document_ids_.end(), document_ids_.end());
+}
+
+SearchServer::DocumentIdIterator::DocumentIdIterator(pmr::vector<int>::const_iterator current, pmr::vector<int>::const_iterator end)
+    : current_(current)
+    , end_(end)
+{
+    SkipRemoved();
+}
+
+SearchServer::DocumentIdIterator::reference SearchServer::DocumentIdIterator::operator*() const {
+    return *current_;
+}
+
+SearchServer::DocumentIdIterator& SearchServer::DocumentIdIterator::operator++() {
+    ++current_;
+    SkipRemoved();
+    return *this;
+}
+
+SearchServer::DocumentIdIterator SearchServer::DocumentIdIterator::operator++(int) {
+    DocumentIdIterator previous = *this;
+    ++*this;
+    return previous;
+}
+
+bool SearchServer::DocumentIdIterator::operator==(const DocumentIdIterator& other) const {
+    return current_ == other.current_;
+}
+
+bool SearchServer::DocumentIdIterator::operator!=(const DocumentIdIterator& other) const {
+    return current_ != other.current_;
+}
+
+void SearchServer::DocumentIdIterator::SkipRemoved() {
+    while (current_ != end_ && *current_ == REMOVED_DOCUMENT_ID) {
+        ++current_;
+    }
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const string_view raw_query, int document_id) const {
@@ -47,57 +114,66 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const str
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::sequenced_policy policy, const string_view raw_query, int document_id) const {
-    if (document_id < 0 || document_to_word_freqs_.count(document_id) == 0) {
+    if (FindDocumentOrdinal(document_id) < 0) {
         throw out_of_range("No document with such id"s);
     }
-
-    const auto query = ParseQuerySorted(raw_query);
-    for (const string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { {}, documents_.at(document_id).status };;
-        }
-    }
-
-    vector<string_view> matched_words;
-    for (const string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(*documents_.at(document_id).words_in_document.find(string(word)));
-        }
-    }
-    return { matched_words, documents_.at(document_id).status };
+    MatchedDocuments matched_documents = MatchDocuments(raw_query, { document_id });
+    return { move(matched_documents.words), matched_documents.statuses[0] };
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::parallel_policy policy, const string_view raw_query, int document_id) const {
-    if (document_id < 0 || document_to_word_freqs_.count(document_id) == 0) {
+    const int ordinal = FindDocumentOrdinal(document_id);
+    if (ordinal < 0) {
         throw out_of_range("No document with such id"s);
     }
 
     const auto query = ParseQuery(raw_query);
-    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), [this, document_id](const string_view minus_word) {
-        return word_to_document_freqs_.at(minus_word).count(document_id);
+    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), [this, ordinal](const string_view minus_word) {
+        return FindWordInDocument(ordinal, minus_word) != nullptr;
         })) {
-        return { {}, documents_.at(document_id).status };
+        return { vector<string_view>{}, document_statuses_[ordinal] };
     }
 
     vector<string_view> matched_words;
-    for_each(query.plus_words.begin(), query.plus_words.end(), [this, document_id, &matched_words](const string_view plus_word) {
-        if (document_to_word_freqs_.at(document_id).count(plus_word)) {
-            matched_words.push_back(*documents_.at(document_id).words_in_document.find(string(plus_word)));
+    for_each(query.plus_words.begin(), query.plus_words.end(), [this, ordinal, &matched_words](const string_view plus_word) {
+        if (const WordFreq* word_freq = FindWordInDocument(ordinal, plus_word)) {
+            matched_words.push_back(word_freq->word);
         }
         });
     sort(policy, matched_words.begin(), matched_words.end());
     matched_words.erase(unique(policy, matched_words.begin(), matched_words.end()), matched_words.end());
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, document_statuses_[ordinal] };
+}
+
+MatchedDocuments SearchServer::MatchDocuments(const string_view raw_query, const vector<int>& document_ids) const {
+    const auto query = ParseQuerySorted(raw_query);
+    const vector<string_view> plus_words = ResolveWords(query.plus_words);
+    const vector<string_view> minus_words = ResolveWords(query.minus_words);
+
+    MatchedDocuments matched_documents;
+    matched_documents.offsets.reserve(document_ids.size() + 1);
+    matched_documents.offsets.push_back(0);
+    matched_documents.statuses.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        const int ordinal = FindDocumentOrdinal(document_id);
+        if (ordinal < 0) {
+            throw out_of_range("No document with such id"s);
+        }
+        if (IntersectWithDocument(ordinal, minus_words, nullptr) == 0) {
+            IntersectWithDocument(ordinal, plus_words, &matched_documents.words);
+        }
+        matched_documents.offsets.push_back(matched_documents.words.size());
+        matched_documents.statuses.push_back(document_statuses_[ordinal]);
+    }
+    return matched_documents;
+}
+
+span<const string_view> MatchedDocuments::GetWords(size_t index) const {
+    return span<const string_view>(words).subspan(offsets[index], offsets[index + 1] - offsets[index]);
 }
 
 bool SearchServer::IsStopWord(string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(string_view word) {
@@ -127,6 +203,59 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
+int SearchServer::FindDocumentOrdinal(int document_id) const {
+    const auto ordinal = document_id_to_ordinal_.find(document_id);
+    if (ordinal == document_id_to_ordinal_.end()) {
+        return -1;
+    }
+    return ordinal->second;
+}
+
+const SearchServer::WordFreq* SearchServer::FindWordInDocument(int ordinal, string_view word) const {
+    const auto first = forward_index_.begin() + forward_index_offsets_[ordinal];
+    const auto last = forward_index_.begin() + forward_index_offsets_[ordinal + 1];
+    const auto word_freq = lower_bound(first, last, word, [](const WordFreq& lhs, string_view rhs) {
+        return lhs.word < rhs;
+        });
+    if (word_freq == last || word_freq->word != word) {
+        return nullptr;
+    }
+    return &*word_freq;
+}
+
+vector<string_view> SearchServer::ResolveWords(const vector<string_view>& words) const {
+    vector<string_view> resolved_words;
+    resolved_words.reserve(words.size());
+    for (const string_view word : words) {
+        const auto stored_word = words_.find(word);
+        if (stored_word != words_.end()) {
+            resolved_words.push_back(*stored_word);
+        }
+    }
+    return resolved_words;
+}
+
+size_t SearchServer::IntersectWithDocument(int ordinal, const vector<string_view>& sorted_words, vector<string_view>* common_words) const {
+    auto first = forward_index_.begin() + forward_index_offsets_[ordinal];
+    const auto last = forward_index_.begin() + forward_index_offsets_[ordinal + 1];
+    size_t common_word_count = 0;
+    for (const string_view word : sorted_words) {
+        first = lower_bound(first, last, word, [](const WordFreq& lhs, string_view rhs) {
+            return lhs.word < rhs;
+            });
+        if (first == last) {
+            break;
+        }
+        if (first->word.data() == word.data()) {
+            ++common_word_count;
+            if (common_words != nullptr) {
+                common_words->push_back(word);
+            }
+        }
+    }
+    return common_word_count;
+}
+
 SearchServer::QueryWord SearchServer::ParseQueryWord(const string_view text) const {
     if (text.empty()) {
         throw invalid_argument("Query word is empty"s);
@@ -170,15 +299,78 @@ SearchServer::Query SearchServer::ParseQuerySorted(const string_view text) const
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.find(word)->second.size());
+double SearchServer::ComputeWordInverseDocumentFreq(const PostingList& posting_list) const {
+    return log_document_count_ - posting_list.log_document_freq;
+}
+
+void SearchServer::CheckCollectionStats(const Query& query, const CollectionStats& collection_stats) const {
+    for (const string_view word : query.plus_words) {
+        const auto posting_list = word_to_document_freqs_.find(word);
+        if (posting_list == word_to_document_freqs_.end()) {
+            continue;
+        }
+        const auto document_freq = collection_stats.document_freqs.find(word);
+        if (document_freq == collection_stats.document_freqs.end()
+            || document_freq->second < static_cast<int>(posting_list->second.postings.size())
+            || document_freq->second > collection_stats.document_count) {
+            throw invalid_argument("Collection stats do not match query word "s + string(word));
+        }
+    }
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(const CollectionStats& collection_stats, string_view word) {
+    return log(collection_stats.document_count * 1.0 / collection_stats.document_freqs.find(word)->second);
+}
+
+CollectionStats SearchServer::GetCollectionStats(const string_view raw_query) const {
+    if (!IsValidWord(raw_query)) {
+        throw invalid_argument("Query contains invalid symbols"s);
+    }
+    CollectionStats collection_stats;
+    collection_stats.document_count = GetDocumentCount();
+    for (const string_view word : ParseQuerySorted(raw_query).plus_words) {
+        const auto posting_list = word_to_document_freqs_.find(word);
+        collection_stats.document_freqs[std::string(word)] = posting_list == word_to_document_freqs_.end() ? 0 : static_cast<int>(posting_list->second.postings.size());
+    }
+    return collection_stats;
+}
+
+AllocationStats SearchServer::GetIndexAllocationStats() const {
+    return index_memory_.GetStats();
+}
+
+AllocationStats SearchServer::GetQueryAllocationStats() const {
+    return query_memory_.GetStats();
+}
+
+void SearchServer::BuildImpactScores() {
+    double max_impact = 0.0;
+    for (const auto& [word, posting_list] : word_to_document_freqs_) {
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(posting_list);
+        for (const Posting& posting : posting_list.postings) {
+            max_impact = max(max_impact, posting.term_freq * inverse_document_freq);
+        }
+    }
+    impact_scale_ = max_impact > 0.0 ? max_impact / numeric_limits<uint16_t>::max() : 1.0;
+    for (auto& [word, posting_list] : word_to_document_freqs_) {
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(posting_list);
+        posting_list.impacts.resize(posting_list.postings.size());
+        for (size_t i = 0; i < posting_list.postings.size(); ++i) {
+            posting_list.impacts[i] = static_cast<uint16_t>(lround(posting_list.postings[i].term_freq * inverse_document_freq / impact_scale_));
+        }
+    }
+    has_impact_scores_ = true;
 }
 
 const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
+    const int ordinal = FindDocumentOrdinal(document_id);
+    if (ordinal < 0) {
+        throw out_of_range("No document with such id"s);
+    }
     static map<string_view, double> result;
     result.clear();
-    for (const auto& [word, freqs] : document_to_word_freqs_.at(document_id)) {
-        result[word] = freqs;
+    for (size_t i = forward_index_offsets_[ordinal]; i < forward_index_offsets_[ordinal + 1]; ++i) {
+        result[forward_index_[i].word] = forward_index_[i].term_freq;
     }
     return result;
 }
@@ -188,21 +380,19 @@ vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) con
 }
 
 vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-        });
+    return FindTopDocuments(execution::seq, raw_query, status);
+}
+
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status, int min_rating, int max_rating) const {
+    return FindTopDocuments(execution::seq, raw_query, status, min_rating, max_rating);
+}
+
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status, const CollectionStats& collection_stats) const {
+    return FindTopDocuments(execution::seq, raw_query, status, collection_stats);
 }
 
 void SearchServer::RemoveDocument(execution::sequenced_policy policy, int document_id) {
-    if (documents_.count(document_id) == 0) {
-        return;
-    }
-    for (const auto& [word, freq] : document_to_word_freqs_.at(document_id)) {
-        word_to_document_freqs_[word].erase(document_id);
-    }
-    documents_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
-    document_ids_.erase(document_id);
+    RemoveDocuments(policy, { document_id });
 }
 
 void SearchServer::RemoveDocument(int document_id) {
@@ -210,19 +400,161 @@ void SearchServer::RemoveDocument(int document_id) {
 }
 
 void SearchServer::RemoveDocument(execution::parallel_policy policy, int document_id) {
-    if (documents_.count(document_id) == 0) {
-        return;
+    RemoveDocuments(policy, { document_id });
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    RemoveDocuments(execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(execution::sequenced_policy policy, const vector<int>& document_ids) {
+    RemoveDocumentsWithPolicy(policy, document_ids);
+}
+
+void SearchServer::RemoveDocuments(execution::parallel_policy policy, const vector<int>& document_ids) {
+    RemoveDocumentsWithPolicy(policy, document_ids);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocumentsWithPolicy(ExecutionPolicy policy, const vector<int>& document_ids) {
+    vector<uint64_t> removed_documents((document_ids_.size() + 63) / 64);
+    vector<string_view> affected_words;
+    for (const int document_id : document_ids) {
+        const int ordinal = FindDocumentOrdinal(document_id);
+        if (ordinal < 0) {
+            continue;
+        }
+        removed_documents[ordinal >> 6] |= uint64_t(1) << (ordinal & 63);
+        for (size_t i = forward_index_offsets_[ordinal]; i < forward_index_offsets_[ordinal + 1]; ++i) {
+            affected_words.push_back(forward_index_[i].word);
+        }
+        document_ids_[ordinal] = REMOVED_DOCUMENT_ID;
+        document_id_to_ordinal_.erase(document_id);
+        ++removed_document_count_;
     }
-    std::vector<const std::string*> words(document_to_word_freqs_.at(document_id).size());
-    std::transform(policy, document_to_word_freqs_.at(document_id).begin(),
-        document_to_word_freqs_.at(document_id).end(), words.begin(), [](auto& word) {
-            return (&word.first);
+
+    // every word is a view into words_, so equal words share the same address
+    sort(policy, affected_words.begin(), affected_words.end(), [](string_view lhs, string_view rhs) {
+        return less<const char*>()(lhs.data(), rhs.data());
+        });
+    affected_words.erase(unique(policy, affected_words.begin(), affected_words.end(), [](string_view lhs, string_view rhs) {
+        return lhs.data() == rhs.data();
+        }), affected_words.end());
+
+    vector<PostingList*> affected_postings(affected_words.size());
+    transform(policy, affected_words.begin(), affected_words.end(), affected_postings.begin(), [this](string_view word) {
+        return &word_to_document_freqs_.find(word)->second;
         });
-    std::for_each(policy, words.begin(), words.end(), [this, document_id](auto& word) {
-        word_to_document_freqs_.find(*word)->second.erase(document_id);
+    for_each(policy, affected_postings.begin(), affected_postings.end(), [&removed_documents](PostingList* posting_list) {
+        pmr::vector<Posting>& postings = posting_list->postings;
+        postings.erase(remove_if(postings.begin(), postings.end(), [&removed_documents](const Posting& posting) {
+            return ContainsOrdinal(removed_documents, posting.ordinal);
+            }), postings.end());
+        posting_list->log_document_freq = log(postings.size());
         });
 
-    documents_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
-    document_ids_.erase(document_id);
+    {
+        lock_guard guard(excluded_documents_cache_mutex_);
+        for (const string_view word : affected_words) {
+            excluded_documents_cache_.erase(word);
+        }
+    }
+    for (size_t i = 0; i < affected_words.size(); ++i) {
+        if (affected_postings[i]->postings.empty()) {
+            word_to_document_freqs_.erase(affected_words[i]);
+            words_.erase(words_.find(affected_words[i]));
+        }
+    }
+
+    log_document_count_ = log(GetDocumentCount());
+    has_impact_scores_ = false;
+
+    if (removed_document_count_ * 2 > document_ids_.size()) {
+        CompactDocuments(policy);
+    }
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::CompactDocuments(ExecutionPolicy policy) {
+    vector<int> new_ordinals(document_ids_.size(), -1);
+    pmr::vector<int> document_ids(&index_memory_);
+    pmr::vector<int> document_ratings(&index_memory_);
+    pmr::vector<DocumentStatus> document_statuses(&index_memory_);
+    pmr::vector<size_t> forward_index_offsets(1, 0, &index_memory_);
+    pmr::vector<WordFreq> forward_index(&index_memory_);
+    const size_t document_count = document_id_to_ordinal_.size();
+    document_ids.reserve(document_count);
+    document_ratings.reserve(document_count);
+    document_statuses.reserve(document_count);
+    forward_index_offsets.reserve(document_count + 1);
+
+    for (int ordinal = 0; ordinal < static_cast<int>(document_ids_.size()); ++ordinal) {
+        if (document_ids_[ordinal] == REMOVED_DOCUMENT_ID) {
+            continue;
+        }
+        const int new_ordinal = static_cast<int>(document_ids.size());
+        new_ordinals[ordinal] = new_ordinal;
+        document_ids.push_back(document_ids_[ordinal]);
+        document_ratings.push_back(document_ratings_[ordinal]);
+        document_statuses.push_back(document_statuses_[ordinal]);
+        forward_index.insert(forward_index.end(), forward_index_.begin() + forward_index_offsets_[ordinal],
+            forward_index_.begin() + forward_index_offsets_[ordinal + 1]);
+        forward_index_offsets.push_back(forward_index.size());
+        document_id_to_ordinal_[document_ids_[ordinal]] = new_ordinal;
+    }
+
+    for_each(policy, word_to_document_freqs_.begin(), word_to_document_freqs_.end(), [&new_ordinals](auto& word_postings) {
+        for (Posting& posting : word_postings.second.postings) {
+            posting.ordinal = new_ordinals[posting.ordinal];
+        }
+        });
+
+    document_ids_ = move(document_ids);
+    document_ratings_ = move(document_ratings);
+    document_statuses_ = move(document_statuses);
+    forward_index_offsets_ = move(forward_index_offsets);
+    forward_index_ = move(forward_index);
+    removed_document_count_ = 0;
+    lock_guard guard(excluded_documents_cache_mutex_);
+    excluded_documents_cache_.clear();
+}
+
+pmr::vector<uint64_t> SearchServer::BuildExcludedDocuments(const vector<string_view>& minus_words, pmr::memory_resource* memory_resource) const {
+    pmr::vector<uint64_t> excluded_documents(memory_resource);
+    for (const string_view word : minus_words) {
+        const auto posting_list = word_to_document_freqs_.find(word);
+        if (posting_list == word_to_document_freqs_.end() || posting_list->second.postings.empty()) {
+            continue;
+        }
+        const pmr::vector<Posting>& postings = posting_list->second.postings;
+        excluded_documents.resize((document_ids_.size() + 63) / 64);
+        if (postings.size() * 64 >= document_ids_.size()) {
+            const pmr::vector<uint64_t>& cached = GetCachedExcludedDocuments(posting_list->first, postings);
+            for (size_t i = 0; i < cached.size(); ++i) {
+                excluded_documents[i] |= cached[i];
+            }
+            continue;
+        }
+        for (const Posting& posting : postings) {
+            excluded_documents[posting.ordinal >> 6] |= uint64_t(1) << (posting.ordinal & 63);
+        }
+    }
+    return excluded_documents;
+}
+
+const pmr::vector<uint64_t>& SearchServer::GetCachedExcludedDocuments(string_view word, const pmr::vector<Posting>& postings) const {
+    lock_guard guard(excluded_documents_cache_mutex_);
+    auto [cached, inserted] = excluded_documents_cache_.try_emplace(word);
+    if (inserted) {
+        cached->second.resize((postings.back().ordinal + 64) / 64);
+        for (const Posting& posting : postings) {
+            cached->second[posting.ordinal >> 6] |= uint64_t(1) << (posting.ordinal & 63);
+        }
+    }
+    return cached->second;
+}
+
+void SearchServer::InvalidateExcludedDocuments(string_view word) {
+    lock_guard guard(excluded_documents_cache_mutex_);
+    excluded_documents_cache_.erase(word);
 }
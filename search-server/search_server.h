@@ -2,6 +2,9 @@
 #include <string>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <iterator>
+#include <mutex>
 #include <stdexcept>
 #include <vector>
 #include <thread>
@@ -10,21 +13,81 @@
 #include <execution>
 #include <functional>
 #include <type_traits>
+#include <limits>
+#include <memory_resource>
+#include <span>
 #include "document.h"
+#include "flat_string_set.h"
+#include "memory_resources.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const int ACCURACY = 1e-6;
 
+// Document count and document frequencies of query words. Servers holding parts of one collection
+// exchange these to rank documents with the IDF of the whole collection. The words are owned, so
+// the stats do not depend on the query text they were gathered for.
+struct CollectionStats {
+    int document_count = 0;
+    std::map<std::string, int, std::less<>> document_freqs;
+};
+
+// Matched words of several documents stored back to back: words of the i-th document
+// are words[offsets[i]] .. words[offsets[i + 1] - 1].
+struct MatchedDocuments {
+    std::vector<std::string_view> words;
+    std::vector<size_t> offsets;
+    std::vector<DocumentStatus> statuses;
+
+    std::span<const std::string_view> GetWords(size_t index) const;
+};
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
 class SearchServer {
 public:
-    typedef std::set<int>::const_iterator const it;
+    class DocumentIdIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        DocumentIdIterator(std::pmr::vector<int>::const_iterator current, std::pmr::vector<int>::const_iterator end);
+
+        reference operator*() const;
+        DocumentIdIterator& operator++();
+        DocumentIdIterator operator++(int);
+        bool operator==(const DocumentIdIterator& other) const;
+        bool operator!=(const DocumentIdIterator& other) const;
+
+    private:
+        std::pmr::vector<int>::const_iterator current_;
+        std::pmr::vector<int>::const_iterator end_;
+
+        void SkipRemoved();
+    };
+
+    typedef DocumentIdIterator it;
 
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
-    explicit SearchServer(const std::string_view stop_words_text);
-    explicit SearchServer(const std::string& stop_words_text);
+    explicit SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
+    // Uses a stop-word table built by MakeFlatStringTable, typically a constexpr one baked into the
+    // binary. The table is not copied and must outlive the server.
+    template <size_t Capacity>
+    explicit SearchServer(const FlatStringTable<Capacity>& stop_words, std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
+    template <size_t Capacity>
+    explicit SearchServer(const FlatStringTable<Capacity>&& stop_words, std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource()) = delete;
+    explicit SearchServer(const std::string_view stop_words_text, std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
+    explicit SearchServer(const std::string& stop_words_text, std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
+
+    // Index containers allocate through the server's own memory resources and the minus-word cache
+    // is guarded by a mutex, so a server can be neither copied nor moved. Hold it by pointer when it
+    // has to change owners.
+    SearchServer(const SearchServer&) = delete;
+    SearchServer& operator=(const SearchServer&) = delete;
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
     
@@ -38,6 +101,17 @@ public:
     std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const;
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, int min_rating, int max_rating) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, int min_rating, int max_rating) const;
+    // Ranks with the IDF of the whole collection. Stats must come from GetCollectionStats of every
+    // server holding a part of the collection, summed up; invalid_argument is thrown when they miss
+    // a query word this server has or cannot account for its documents.
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, const CollectionStats& collection_stats) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, const CollectionStats& collection_stats) const;
+
+    CollectionStats GetCollectionStats(const std::string_view raw_query) const;
 
     int GetDocumentCount() const;
 
@@ -48,23 +122,76 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy policy, const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query, int document_id) const;
 
+    MatchedDocuments MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::sequenced_policy polic, int document_id);
     void RemoveDocument(std::execution::parallel_policy policy, int document_id);
 
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void RemoveDocuments(std::execution::sequenced_policy policy, const std::vector<int>& document_ids);
+    void RemoveDocuments(std::execution::parallel_policy policy, const std::vector<int>& document_ids);
+
+    // Stores tf-idf of every posting quantized to 16 bits, so that sequential queries sum integers
+    // instead of recomputing doubles. Quantization step is max(tf-idf) / 65535 <= ln(N) / 65535,
+    // so relevance differs from the exact one by at most plus_word_count * ln(N) / 131070 and only
+    // documents closer than twice that can swap places. Any AddDocument/RemoveDocument makes
+    // queries fall back to exact scoring until impact scores are built again.
+    void BuildImpactScores();
+
+    // Allocations of the index, including the minus-word cache, made through the memory resource
+    // passed to the constructor.
+    AllocationStats GetIndexAllocationStats() const;
+    // Only allocations that overflow the per-thread scratch arena of a query. Parsing the query and
+    // building the result vector still go to the default heap and are not counted.
+    AllocationStats GetQueryAllocationStats() const;
+
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::set<std::string> words_in_document;
+    static const int REMOVED_DOCUMENT_ID = -1;
+
+    struct Posting {
+        int ordinal;
+        double term_freq;
+    };
+
+    struct PostingList {
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        explicit PostingList(const allocator_type& allocator)
+            : postings(allocator)
+            , impacts(allocator) {
+        }
+
+        std::pmr::vector<Posting> postings;
+        std::pmr::vector<uint16_t> impacts;
+        double log_document_freq = 0.0;
+    };
+
+    struct WordFreq {
+        std::string_view word;
+        double term_freq;
     };
-    const std::set<std::string, std::less<>> stop_words_;
-    std::map<int, std::map<std::string, double, std::less<>>> document_to_word_freqs_;
-    std::map<std::string_view, std::map<int, double>, std::less<>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+
+    const FlatStringSet stop_words_;
+    CountingMemoryResource index_memory_;
+    mutable CountingMemoryResource query_memory_;
+    std::pmr::set<std::pmr::string, std::less<>> words_{ &index_memory_ };
+    std::pmr::map<std::string_view, PostingList, std::less<>> word_to_document_freqs_{ &index_memory_ };
+    double log_document_count_ = 0.0;
+    double impact_scale_ = 0.0;
+    bool has_impact_scores_ = false;
+
+    std::pmr::unordered_map<int, int> document_id_to_ordinal_{ &index_memory_ };
+    std::pmr::vector<int> document_ids_{ &index_memory_ };
+    std::pmr::vector<int> document_ratings_{ &index_memory_ };
+    std::pmr::vector<DocumentStatus> document_statuses_{ &index_memory_ };
+    std::pmr::vector<size_t> forward_index_offsets_{ &index_memory_ };
+    std::pmr::vector<WordFreq> forward_index_{ &index_memory_ };
+    size_t removed_document_count_ = 0;
+    mutable std::mutex excluded_documents_cache_mutex_;
+    mutable std::pmr::map<std::string_view, std::pmr::vector<uint64_t>, std::less<>> excluded_documents_cache_{ &index_memory_ };
 
     bool IsStopWord(std::string_view word) const;
     static bool IsValidWord(std::string_view word);
@@ -85,42 +212,87 @@ private:
         std::vector<std::string_view> minus_words;
     };
 
+    int FindDocumentOrdinal(int document_id) const;
+    const WordFreq* FindWordInDocument(int ordinal, std::string_view word) const;
+    std::vector<std::string_view> ResolveWords(const std::vector<std::string_view>& words) const;
+    size_t IntersectWithDocument(int ordinal, const std::vector<std::string_view>& sorted_words, std::vector<std::string_view>* common_words) const;
+    template <typename ExecutionPolicy>
+    void RemoveDocumentsWithPolicy(ExecutionPolicy policy, const std::vector<int>& document_ids);
+    template <typename ExecutionPolicy>
+    void CompactDocuments(ExecutionPolicy policy);
+    std::pmr::vector<uint64_t> BuildExcludedDocuments(const std::vector<std::string_view>& minus_words, std::pmr::memory_resource* memory_resource) const;
+    const std::pmr::vector<uint64_t>& GetCachedExcludedDocuments(std::string_view word, const std::pmr::vector<Posting>& postings) const;
+    void InvalidateExcludedDocuments(std::string_view word);
+    static bool ContainsOrdinal(std::span<const uint64_t> ordinals, int ordinal);
+
     Query ParseQuery(const std::string_view text) const;
     Query ParseQuerySorted(const std::string_view text) const;
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    double ComputeWordInverseDocumentFreq(const PostingList& posting_list) const;
+    void CheckCollectionStats(const Query& query, const CollectionStats& collection_stats) const;
+    static double ComputeWordInverseDocumentFreq(const CollectionStats& collection_stats, std::string_view word);
 
-    template <typename FilterFunction>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy policy, const Query& query, FilterFunction filter_function) const;
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsByPredicate(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+        const CollectionStats* collection_stats = nullptr) const;
 
-    template <typename FilterFunction>
-    std::vector<Document> FindAllDocuments(std::execution::parallel_policy policy, const Query& query, FilterFunction filter_function) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy policy, const Query& query, DocumentPredicate document_predicate,
+        const CollectionStats* collection_stats) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(std::execution::parallel_policy policy, const Query& query, DocumentPredicate document_predicate,
+        const CollectionStats* collection_stats) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocumentsByImpact(const Query& query, DocumentPredicate document_predicate) const;
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
+SearchServer::SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* memory_resource)
     : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+    , index_memory_(memory_resource)
+    , query_memory_(std::pmr::get_default_resource())
 {
+    forward_index_offsets_.push_back(0);
     using namespace std::string_literals;
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+    if (!all_of(stop_words_.GetSlots().begin(), stop_words_.GetSlots().end(), IsValidWord)) {
+        throw std::invalid_argument("Some of stop words are invalid"s);
+    }
+}
+
+template <size_t Capacity>
+SearchServer::SearchServer(const FlatStringTable<Capacity>& stop_words, std::pmr::memory_resource* memory_resource)
+    : stop_words_(stop_words)
+    , index_memory_(memory_resource)
+    , query_memory_(std::pmr::get_default_resource())
+{
+    forward_index_offsets_.push_back(0);
+    using namespace std::string_literals;
+    if (!all_of(stop_words.slots.begin(), stop_words.slots.end(), IsValidWord)) {
         throw std::invalid_argument("Some of stop words are invalid"s);
     }
 }
 
 template <typename ExecutionPolicy, typename FilterFunction>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, FilterFunction filter_function) const {
+    return FindTopDocumentsByPredicate(policy, raw_query, [this, &filter_function](int ordinal) {
+        return filter_function(document_ids_[ordinal], document_statuses_[ordinal], document_ratings_[ordinal]);
+        });
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsByPredicate(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+    const CollectionStats* collection_stats) const {
     if (!IsValidWord(raw_query)) {
         throw std::invalid_argument("Query contains invalid symbols");
     }
     const auto query = ParseQuerySorted(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, filter_function);
-    std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < ACCURACY) {
-            return lhs.rating > rhs.rating;
-        }
-        else {
-            return lhs.relevance > rhs.relevance;
-        }
-        });
+    // checked up front, a throw from inside a parallel algorithm would terminate the program
+    if (collection_stats != nullptr) {
+        CheckCollectionStats(query, *collection_stats);
+    }
+    auto matched_documents = FindAllDocuments(policy, query, document_predicate, collection_stats);
+    std::sort(matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
     if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
         matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
@@ -135,8 +307,14 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
 
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
+    return FindTopDocuments(policy, raw_query, status, std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, int min_rating, int max_rating) const {
+    return FindTopDocumentsByPredicate(policy, raw_query, [this, status, min_rating, max_rating](int ordinal) {
+        const int rating = document_ratings_[ordinal];
+        return document_statuses_[ordinal] == status && rating >= min_rating && rating <= max_rating;
         });
 }
 
@@ -145,68 +323,104 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, co
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename FilterFunction>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy policy, const Query& query, FilterFunction filter_function) const {
-    std::map<int, double> document_to_relevance;
+inline bool SearchServer::ContainsOrdinal(std::span<const uint64_t> ordinals, int ordinal) {
+    const size_t word_index = static_cast<size_t>(ordinal) >> 6;
+    return word_index < ordinals.size() && ((ordinals[word_index] >> (ordinal & 63)) & 1);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, const CollectionStats& collection_stats) const {
+    return FindTopDocumentsByPredicate(policy, raw_query, [this, status](int ordinal) {
+        return document_statuses_[ordinal] == status;
+        }, &collection_stats);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy policy, const Query& query, DocumentPredicate document_predicate,
+    const CollectionStats* collection_stats) const {
+    if (has_impact_scores_ && collection_stats == nullptr) {
+        return FindAllDocumentsByImpact(query, document_predicate);
+    }
+    ScratchArena scratch(&query_memory_);
+    const std::pmr::vector<uint64_t> excluded_documents = BuildExcludedDocuments(query.minus_words, scratch.Get());
+    std::pmr::map<int, double> document_to_relevance(scratch.Get());
     for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        const auto posting_list = word_to_document_freqs_.find(word);
+        if (posting_list == word_to_document_freqs_.end()) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (filter_function(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        const double inverse_document_freq = collection_stats == nullptr ? ComputeWordInverseDocumentFreq(posting_list->second)
+            : ComputeWordInverseDocumentFreq(*collection_stats, word);
+        for (const auto [ordinal, term_freq] : posting_list->second.postings) {
+            if (!ContainsOrdinal(excluded_documents, ordinal) && document_predicate(ordinal)) {
+                document_to_relevance[ordinal] += term_freq * inverse_document_freq;
             }
         }
     }
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
-        }
-    }
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    for (const auto [ordinal, relevance] : document_to_relevance) {
+        matched_documents.push_back({ document_ids_[ordinal], relevance, document_ratings_[ordinal] });
     }
     return matched_documents;
 }
 
-template <typename FilterFunction>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy policy, const Query& query, FilterFunction filter_function) const {
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy policy, const Query& query, DocumentPredicate document_predicate,
+    const CollectionStats* collection_stats) const {
 
     unsigned int threads_ = std::thread::hardware_concurrency();
     ConcurrentMap<int, double> document_to_relevance(threads_);
+    ScratchArena scratch(&query_memory_);
+    const std::pmr::vector<uint64_t> excluded_documents = BuildExcludedDocuments(query.minus_words, scratch.Get());
 
-    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), [this, &document_to_relevance, &filter_function](const std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    std::for_each(policy, query.plus_words.begin(), query.plus_words.end(), [this, &document_to_relevance, &excluded_documents, &document_predicate, collection_stats](const std::string_view word) {
+        const auto posting_list = word_to_document_freqs_.find(word);
+        if (posting_list == word_to_document_freqs_.end()) {
             return;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (filter_function(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+        const double inverse_document_freq = collection_stats == nullptr ? ComputeWordInverseDocumentFreq(posting_list->second)
+            : ComputeWordInverseDocumentFreq(*collection_stats, word);
+        for (const auto [ordinal, term_freq] : posting_list->second.postings) {
+            if (!ContainsOrdinal(excluded_documents, ordinal) && document_predicate(ordinal)) {
+                document_to_relevance[ordinal].ref_to_value += term_freq * inverse_document_freq;
             }
         }
         });
 
-    std::for_each(policy, query.minus_words.begin(), query.minus_words.end(), [this, &document_to_relevance](const std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
+    std::map<int, double> result = document_to_relevance.BuildOrdinaryMap();
+    std::vector<Document> matched_documents;
+    for (const auto [ordinal, relevance] : result) {
+        matched_documents.push_back({ document_ids_[ordinal], relevance, document_ratings_[ordinal] });
+    }
+    return matched_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocumentsByImpact(const Query& query, DocumentPredicate document_predicate) const {
+    ScratchArena scratch(&query_memory_);
+    const std::pmr::vector<uint64_t> excluded_documents = BuildExcludedDocuments(query.minus_words, scratch.Get());
+    ScratchCounters document_to_impact(document_ids_.size(), scratch.Get());
+    for (const std::string_view word : query.plus_words) {
+        const auto posting_list = word_to_document_freqs_.find(word);
+        if (posting_list == word_to_document_freqs_.end()) {
+            continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.Erase(document_id);
+        const std::pmr::vector<Posting>& postings = posting_list->second.postings;
+        const std::pmr::vector<uint16_t>& impacts = posting_list->second.impacts;
+        for (size_t i = 0; i < postings.size(); ++i) {
+            const int ordinal = postings[i].ordinal;
+            if (ContainsOrdinal(excluded_documents, ordinal) || !document_predicate(ordinal)) {
+                continue;
+            }
+            document_to_impact.Add(ordinal, impacts[i]);
         }
-        });
-
-    std::map<int, double> result = document_to_relevance.BuildOrdinaryMap();
+    }
+    const std::span<size_t> matched_ordinals = document_to_impact.GetTouchedIndices();
+    std::sort(matched_ordinals.begin(), matched_ordinals.end());
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : result) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    matched_documents.reserve(matched_ordinals.size());
+    for (const size_t ordinal : matched_ordinals) {
+        matched_documents.push_back({ document_ids_[ordinal], document_to_impact[ordinal] * impact_scale_, document_ratings_[ordinal] });
     }
     return matched_documents;
 }
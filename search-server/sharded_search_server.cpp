@@ -0,0 +1,94 @@
+#include "sharded_search_server.h"
+#include <algorithm>
+#include <execution>
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const string_view stop_words_text)
+    : ShardedSearchServer(shard_count, SplitIntoWords(stop_words_text))
+{
+}
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const string& stop_words_text)
+    : ShardedSearchServer(shard_count, SplitIntoWords(stop_words_text))
+{
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
+    if (document_id < 0) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    shards_[GetShardIndex(document_id)]->AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    RemoveDocuments({ document_id });
+}
+
+void ShardedSearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    vector<vector<int>> shard_document_ids(shards_.size());
+    for (const int document_id : document_ids) {
+        if (document_id >= 0) {
+            shard_document_ids[GetShardIndex(document_id)].push_back(document_id);
+        }
+    }
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (!shard_document_ids[i].empty()) {
+            shards_[i]->RemoveDocuments(shard_document_ids[i]);
+        }
+    }
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
+    // gathered sequentially, so that an invalid query throws here rather than inside a parallel algorithm
+    CollectionStats collection_stats;
+    for (const auto& shard : shards_) {
+        const CollectionStats shard_stats = shard->GetCollectionStats(raw_query);
+        collection_stats.document_count += shard_stats.document_count;
+        for (const auto& [word, document_freq] : shard_stats.document_freqs) {
+            collection_stats.document_freqs.try_emplace(word).first->second += document_freq;
+        }
+    }
+
+    vector<vector<Document>> shard_documents(shards_.size());
+    transform(execution::par, shards_.begin(), shards_.end(), shard_documents.begin(),
+        [raw_query, status, &collection_stats](const unique_ptr<SearchServer>& shard) {
+            return shard->FindTopDocuments(raw_query, status, collection_stats);
+        });
+
+    vector<Document> matched_documents;
+    for (const vector<Document>& documents : shard_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    sort(matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return matched_documents;
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const auto& shard : shards_) {
+        document_count += shard->GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t shard_index) const {
+    return *shards_.at(shard_index);
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // Fibonacci hashing spreads sequential ids evenly among shards
+    const uint64_t hash = static_cast<uint64_t>(document_id) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>((hash >> 32) % shards_.size());
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "document.h"
+#include "search_server.h"
+
+// Splits documents between several SearchServer shards by hash of their id. Queries are broadcast
+// to every shard with document frequencies summed over all shards, so relevance is the same as
+// if the whole collection were kept in a single server, and per-shard top documents are merged.
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(size_t shard_count, const StringContainer& stop_words);
+    // Shards refer to a stop-word table without copying it, so it must not be a temporary.
+    template <size_t Capacity>
+    ShardedSearchServer(size_t shard_count, const FlatStringTable<Capacity>&& stop_words) = delete;
+    ShardedSearchServer(size_t shard_count, const std::string_view stop_words_text);
+    ShardedSearchServer(size_t shard_count, const std::string& stop_words_text);
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+    size_t GetShardCount() const;
+    const SearchServer& GetShard(size_t shard_index) const;
+
+private:
+    std::vector<std::unique_ptr<SearchServer>> shards_;
+
+    size_t GetShardIndex(int document_id) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const StringContainer& stop_words) {
+    using namespace std::string_literals;
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<SearchServer>(stop_words));
+    }
+}
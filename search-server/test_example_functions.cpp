@@ -0,0 +1,568 @@
+#include "test_example_functions.h"
+#include "log_duration.h"
+#include "sharded_search_server.h"
+#include "string_processing.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <random>
+
+using namespace std;
+
+#define ASSERT(expr) AssertImpl((expr), #expr, __FILE__, __LINE__)
+
+namespace {
+    void AssertImpl(bool value, const string& expr, const string& file, int line) {
+        if (!value) {
+            cerr << file << "("s << line << "): ASSERT("s << expr << ") failed."s << endl;
+            abort();
+        }
+    }
+
+    string GenerateWord(mt19937& generator, int max_length) {
+        const int length = uniform_int_distribution(1, max_length)(generator);
+        string word;
+        word.reserve(length);
+        for (int i = 0; i < length; ++i) {
+            word.push_back(uniform_int_distribution('a', 'z')(generator));
+        }
+        return word;
+    }
+
+    vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+        vector<string> words;
+        words.reserve(word_count);
+        for (int i = 0; i < word_count; ++i) {
+            words.push_back(GenerateWord(generator, max_length));
+        }
+        sort(words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
+        return words;
+    }
+
+    string GenerateText(mt19937& generator, const vector<string>& dictionary, int word_count) {
+        string text;
+        for (int i = 0; i < word_count; ++i) {
+            if (i > 0) {
+                text.push_back(' ');
+            }
+            text += dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)];
+        }
+        return text;
+    }
+
+    vector<string> GenerateDocuments(mt19937& generator, const vector<string>& dictionary, int document_count, int word_count) {
+        vector<string> documents;
+        documents.reserve(document_count);
+        for (int i = 0; i < document_count; ++i) {
+            documents.push_back(GenerateText(generator, dictionary, word_count));
+        }
+        return documents;
+    }
+
+    void AddDocuments(SearchServer& search_server, const vector<string>& documents) {
+        for (int i = 0; i < static_cast<int>(documents.size()); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+    }
+
+    bool HaveSameDocuments(const vector<Document>& lhs, const vector<Document>& rhs) {
+        return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& lhs, const Document& rhs) {
+            return lhs.id == rhs.id && lhs.rating == rhs.rating && abs(lhs.relevance - rhs.relevance) < 1e-12;
+            });
+    }
+
+    // Documents of equal relevance may come in any order, so only the relevance at each position is compared.
+    bool HaveSameRelevances(const vector<Document>& lhs, const vector<Document>& rhs) {
+        return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& lhs, const Document& rhs) {
+            return abs(lhs.relevance - rhs.relevance) < 1e-12;
+            });
+    }
+
+    vector<string_view> GetMatchedWords(const SearchServer& search_server, const string_view raw_query, int document_id) {
+        return get<0>(search_server.MatchDocument(raw_query, document_id));
+    }
+
+    void TestRemoveDocumentsWithCompaction() {
+        SearchServer search_server("and in"s);
+        search_server.AddDocument(4, "white cat and fancy collar"sv, DocumentStatus::ACTUAL, { 8, -3 });
+        search_server.AddDocument(1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        search_server.AddDocument(7, "groomed dog expressive eyes"sv, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+        search_server.AddDocument(3, "groomed starling eugene"sv, DocumentStatus::BANNED, { 9 });
+        search_server.AddDocument(9, "lonely parrot in cage"sv, DocumentStatus::ACTUAL, { 1 });
+        search_server.AddDocument(2, "cat in cage"sv, DocumentStatus::ACTUAL, { 3 });
+
+        // two holes out of six ordinals, the columns are not compacted yet; unknown ids are ignored
+        search_server.RemoveDocuments({ 7, 9, 100 });
+        ASSERT(search_server.GetDocumentCount() == 4);
+        ASSERT(search_server.FindTopDocuments("parrot"sv).empty());
+        ASSERT(search_server.FindTopDocuments("dog"sv).empty());
+
+        // two more make the holes a majority and trigger compaction
+        search_server.RemoveDocuments(execution::par, { 4, 3 });
+        ASSERT(search_server.GetDocumentCount() == 2);
+        ASSERT(vector<int>(search_server.begin(), search_server.end()) == vector<int>({ 1, 2 }));
+        ASSERT(search_server.FindTopDocuments("groomed"sv, DocumentStatus::BANNED).empty());
+
+        SearchServer expected_server("and in"s);
+        expected_server.AddDocument(1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        expected_server.AddDocument(2, "cat in cage"sv, DocumentStatus::ACTUAL, { 3 });
+        for (const string_view query : { "cat"sv, "cat cage"sv, "fluffy -cage"sv, "collar"sv }) {
+            ASSERT(HaveSameDocuments(search_server.FindTopDocuments(query), expected_server.FindTopDocuments(query)));
+        }
+
+        ASSERT(GetMatchedWords(search_server, "fluffy cat -collar"sv, 1) == vector<string_view>({ "cat"sv, "fluffy"sv }));
+        ASSERT(GetMatchedWords(search_server, "cat cage"sv, 2) == vector<string_view>({ "cage"sv, "cat"sv }));
+        ASSERT(GetMatchedWords(search_server, "cat -cage"sv, 2).empty());
+        try {
+            search_server.MatchDocument("cat"sv, 4);
+            ASSERT(false);
+        }
+        catch (const out_of_range&) {
+        }
+
+        // removed ids can be added again and land after the compacted documents
+        search_server.AddDocument(7, "cat on fence"sv, DocumentStatus::ACTUAL, { 4 });
+        ASSERT(vector<int>(search_server.begin(), search_server.end()) == vector<int>({ 1, 2, 7 }));
+        const vector<Document> documents = search_server.FindTopDocuments("fence"sv);
+        ASSERT(documents.size() == 1 && documents[0].id == 7);
+    }
+
+    // Removes most of a random collection in three batches, the last one compacts the columns,
+    // and compares every answer with a server built from the surviving documents only.
+    void TestRemoveDocumentsMatchesRebuiltServer() {
+        mt19937 generator;
+        const vector<string> dictionary = GenerateDictionary(generator, 300, 6);
+        const vector<string> documents = GenerateDocuments(generator, dictionary, 2'000, 6);
+        vector<int> ratings;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ratings.push_back(uniform_int_distribution(-10, 10)(generator));
+        }
+        const auto get_status = [](int document_id) {
+            return document_id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        };
+
+        SearchServer search_server(""s);
+        for (int i = 0; i < static_cast<int>(documents.size()); ++i) {
+            search_server.AddDocument(i, documents[i], get_status(i), { ratings[i] });
+        }
+        vector<int> removed_ids(documents.size());
+        iota(removed_ids.begin(), removed_ids.end(), 0);
+        shuffle(removed_ids.begin(), removed_ids.end(), generator);
+        removed_ids.resize(removed_ids.size() * 7 / 10);
+        const auto first_third = removed_ids.begin() + removed_ids.size() / 3;
+        const auto second_third = removed_ids.begin() + removed_ids.size() * 2 / 3;
+        search_server.RemoveDocuments(vector<int>(removed_ids.begin(), first_third));
+        search_server.RemoveDocuments(execution::par, vector<int>(first_third, second_third));
+        search_server.RemoveDocuments(execution::seq, vector<int>(second_third, removed_ids.end()));
+
+        sort(removed_ids.begin(), removed_ids.end());
+        SearchServer expected_server(""s);
+        vector<int> expected_ids;
+        for (int i = 0; i < static_cast<int>(documents.size()); ++i) {
+            if (!binary_search(removed_ids.begin(), removed_ids.end(), i)) {
+                expected_server.AddDocument(i, documents[i], get_status(i), { ratings[i] });
+                expected_ids.push_back(i);
+            }
+        }
+        ASSERT(search_server.GetDocumentCount() == expected_server.GetDocumentCount());
+        ASSERT(vector<int>(search_server.begin(), search_server.end()) == expected_ids);
+
+        for (int i = 0; i < 300; ++i) {
+            string query = GenerateText(generator, dictionary, 3);
+            if (i % 2 == 0) {
+                query += " -"s + GenerateText(generator, dictionary, 1);
+            }
+            const DocumentStatus status = i % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            ASSERT(HaveSameDocuments(search_server.FindTopDocuments(query, status), expected_server.FindTopDocuments(query, status)));
+            const int document_id = expected_ids[uniform_int_distribution<size_t>(0, expected_ids.size() - 1)(generator)];
+            ASSERT(search_server.MatchDocument(query, document_id) == expected_server.MatchDocument(query, document_id));
+        }
+    }
+
+    vector<int> GetSortedIds(const vector<Document>& documents) {
+        vector<int> document_ids;
+        for (const Document& document : documents) {
+            document_ids.push_back(document.id);
+        }
+        sort(document_ids.begin(), document_ids.end());
+        return document_ids;
+    }
+
+    void TestFindTopDocumentsByRatingRange() {
+        SearchServer search_server(""s);
+        search_server.AddDocument(1, "cat"sv, DocumentStatus::ACTUAL, { 2 });
+        search_server.AddDocument(2, "cat"sv, DocumentStatus::ACTUAL, { 3 });
+        search_server.AddDocument(3, "cat"sv, DocumentStatus::ACTUAL, { 4, 6 });
+        search_server.AddDocument(4, "cat"sv, DocumentStatus::BANNED, { 3 });
+        search_server.AddDocument(5, "cat"sv, DocumentStatus::ACTUAL, { 6 });
+        search_server.AddDocument(6, "cat"sv, DocumentStatus::ACTUAL, { 1 });
+
+        // both bounds are inclusive and documents of other statuses are left out
+        ASSERT(GetSortedIds(search_server.FindTopDocuments("cat"sv, DocumentStatus::ACTUAL, 2, 5)) == vector<int>({ 1, 2, 3 }));
+        ASSERT(GetSortedIds(search_server.FindTopDocuments(execution::par, "cat"sv, DocumentStatus::ACTUAL, 2, 5)) == vector<int>({ 1, 2, 3 }));
+        ASSERT(GetSortedIds(search_server.FindTopDocuments(execution::par, "cat"sv, DocumentStatus::BANNED, 3, 3)) == vector<int>({ 4 }));
+        ASSERT(search_server.FindTopDocuments("cat"sv, DocumentStatus::ACTUAL, 6, 1).empty());
+
+        mt19937 generator;
+        const vector<string> dictionary = GenerateDictionary(generator, 200, 6);
+        const vector<string> documents = GenerateDocuments(generator, dictionary, 2'000, 6);
+        SearchServer random_server(""s);
+        for (int i = 0; i < static_cast<int>(documents.size()); ++i) {
+            const DocumentStatus status = static_cast<DocumentStatus>(uniform_int_distribution(0, 3)(generator));
+            random_server.AddDocument(i, documents[i], status, { uniform_int_distribution(-10, 10)(generator) });
+        }
+        for (int i = 0; i < 200; ++i) {
+            const string query = GenerateText(generator, dictionary, 2);
+            const DocumentStatus status = static_cast<DocumentStatus>(i % 4);
+            const int min_rating = uniform_int_distribution(-10, 10)(generator);
+            const int max_rating = min_rating + uniform_int_distribution(0, 5)(generator);
+            const auto filter = [status, min_rating, max_rating](int, DocumentStatus document_status, int rating) {
+                return document_status == status && rating >= min_rating && rating <= max_rating;
+            };
+            ASSERT(HaveSameDocuments(random_server.FindTopDocuments(query, status, min_rating, max_rating),
+                random_server.FindTopDocuments(query, filter)));
+            ASSERT(HaveSameDocuments(random_server.FindTopDocuments(execution::par, query, status, min_rating, max_rating),
+                random_server.FindTopDocuments(execution::par, query, filter)));
+        }
+    }
+
+    bool HaveWords(span<const string_view> words, const vector<string_view>& expected_words) {
+        return equal(words.begin(), words.end(), expected_words.begin(), expected_words.end());
+    }
+
+    void TestMatchDocuments() {
+        SearchServer search_server("in"s);
+        search_server.AddDocument(1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 7 });
+        search_server.AddDocument(2, "cat in cage"sv, DocumentStatus::BANNED, { 2 });
+        search_server.AddDocument(3, "white collar"sv, DocumentStatus::IRRELEVANT, { 1 });
+
+        // a minus word empties document 2, document 3 has no query words, document 1 is asked twice
+        const MatchedDocuments matched_documents = search_server.MatchDocuments("tail cat fluffy -cage"sv, { 1, 2, 3, 1 });
+        ASSERT(matched_documents.offsets.size() == 5 && matched_documents.statuses.size() == 4);
+        ASSERT(HaveWords(matched_documents.GetWords(0), { "cat"sv, "fluffy"sv, "tail"sv }));
+        ASSERT(HaveWords(matched_documents.GetWords(1), {}));
+        ASSERT(HaveWords(matched_documents.GetWords(2), {}));
+        ASSERT(HaveWords(matched_documents.GetWords(3), { "cat"sv, "fluffy"sv, "tail"sv }));
+        ASSERT(matched_documents.statuses == vector<DocumentStatus>({ DocumentStatus::ACTUAL, DocumentStatus::BANNED,
+            DocumentStatus::IRRELEVANT, DocumentStatus::ACTUAL }));
+        for (const int document_id : { 1, 2, 3 }) {
+            const auto [words, status] = search_server.MatchDocument(execution::par, "tail cat fluffy -cage"sv, document_id);
+            const MatchedDocuments single_document = search_server.MatchDocuments("tail cat fluffy -cage"sv, { document_id });
+            ASSERT(HaveWords(single_document.GetWords(0), words) && single_document.statuses[0] == status);
+        }
+
+        const MatchedDocuments no_documents = search_server.MatchDocuments("cat"sv, {});
+        ASSERT(no_documents.offsets == vector<size_t>({ 0 }) && no_documents.words.empty() && no_documents.statuses.empty());
+        try {
+            search_server.MatchDocuments("cat"sv, { 1, 42 });
+            ASSERT(false);
+        }
+        catch (const out_of_range&) {
+        }
+    }
+
+    // Impact scoring accumulates into per-thread counters; leftovers of an earlier, a failed or
+    // an enclosing query must not leak into the next one.
+    void TestImpactScoringClearsCounters() {
+        SearchServer search_server("and in"s);
+        search_server.AddDocument(1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        search_server.AddDocument(2, "cat in cage"sv, DocumentStatus::ACTUAL, { 3 });
+        search_server.AddDocument(3, "groomed dog expressive eyes"sv, DocumentStatus::ACTUAL, { 5 });
+        const vector<Document> expected_documents = search_server.FindTopDocuments("cat dog"sv);
+        search_server.BuildImpactScores();
+        const auto have_expected_documents = [&expected_documents](const vector<Document>& documents) {
+            return equal(documents.begin(), documents.end(), expected_documents.begin(), expected_documents.end(), [](const Document& lhs, const Document& rhs) {
+                return lhs.id == rhs.id && abs(lhs.relevance - rhs.relevance) < 1e-3;
+                });
+        };
+
+        ASSERT(have_expected_documents(search_server.FindTopDocuments("cat dog"sv)));
+        ASSERT(have_expected_documents(search_server.FindTopDocuments("cat dog"sv)));
+        try {
+            search_server.FindTopDocuments("cat dog"sv, [](int document_id, DocumentStatus, int) {
+                if (document_id == 2) {
+                    throw runtime_error("filter failed"s);
+                }
+                return true;
+                });
+            ASSERT(false);
+        }
+        catch (const runtime_error&) {
+        }
+        ASSERT(have_expected_documents(search_server.FindTopDocuments("cat dog"sv)));
+
+        bool nested_query_passed = true;
+        const vector<Document> documents = search_server.FindTopDocuments("cat dog"sv, [&](int, DocumentStatus, int) {
+            nested_query_passed = nested_query_passed && have_expected_documents(search_server.FindTopDocuments("cat dog"sv));
+            return true;
+            });
+        ASSERT(nested_query_passed && have_expected_documents(documents));
+    }
+
+    // Sharded ranking uses the IDF of the whole collection, so it must give the same answers as one
+    // server holding every document.
+    void TestShardedSearchServerMatchesSingleServer() {
+        mt19937 generator;
+        const vector<string> dictionary = GenerateDictionary(generator, 500, 6);
+        const vector<string> documents = GenerateDocuments(generator, dictionary, 20'000, 6);
+        SearchServer single_server(dictionary[0]);
+        ShardedSearchServer sharded_server(4, dictionary[0]);
+        for (int i = 0; i < static_cast<int>(documents.size()); ++i) {
+            const DocumentStatus status = i % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            const vector<int> ratings = { uniform_int_distribution(0, 9)(generator) };
+            single_server.AddDocument(i, documents[i], status, ratings);
+            sharded_server.AddDocument(i, documents[i], status, ratings);
+        }
+        vector<int> removed_ids;
+        for (int i = 0; i < 3'000; ++i) {
+            removed_ids.push_back(uniform_int_distribution(0, static_cast<int>(documents.size()) - 1)(generator));
+        }
+        single_server.RemoveDocuments(removed_ids);
+        sharded_server.RemoveDocuments(removed_ids);
+        ASSERT(sharded_server.GetDocumentCount() == single_server.GetDocumentCount());
+
+        for (int i = 0; i < 500; ++i) {
+            const string query = GenerateText(generator, dictionary, 2) + " -"s + GenerateText(generator, dictionary, 1);
+            ASSERT(HaveSameRelevances(sharded_server.FindTopDocuments(query), single_server.FindTopDocuments(query)));
+            ASSERT(HaveSameRelevances(sharded_server.FindTopDocuments(query, DocumentStatus::BANNED),
+                single_server.FindTopDocuments(query, DocumentStatus::BANNED)));
+        }
+    }
+
+    void TestFindTopDocumentsRejectsInvalidCollectionStats() {
+        SearchServer search_server(""s);
+        search_server.AddDocument(1, "fluffy cat"sv, DocumentStatus::ACTUAL, { 1 });
+        search_server.AddDocument(2, "cat in cage"sv, DocumentStatus::ACTUAL, { 2 });
+        const auto is_rejected = [&search_server](const CollectionStats& collection_stats) {
+            try {
+                search_server.FindTopDocuments(execution::par, "cat fluffy"sv, DocumentStatus::ACTUAL, collection_stats);
+                return false;
+            }
+            catch (const invalid_argument&) {
+                return true;
+            }
+        };
+
+        CollectionStats collection_stats = search_server.GetCollectionStats("cat fluffy"sv);
+        ASSERT(!is_rejected(collection_stats));
+        collection_stats.document_count = 10;
+        collection_stats.document_freqs["cat"s] = 4;
+        ASSERT(!is_rejected(collection_stats));
+        ASSERT(is_rejected({ 10, { { "cat"s, 4 } } }));
+        ASSERT(is_rejected({ 10, { { "cat"s, 4 }, { "fluffy"s, 0 } } }));
+        ASSERT(is_rejected({ 3, { { "cat"s, 4 }, { "fluffy"s, 1 } } }));
+        ASSERT(is_rejected({ 10, { { "cat"s, 1 }, { "fluffy"s, 1 } } }));
+    }
+
+    CollectionStats GetCollectionStatsOfDestroyedQuery(const SearchServer& search_server) {
+        const string raw_query = "fluffy cat with a long tail -collar"s;
+        return search_server.GetCollectionStats(raw_query);
+    }
+
+    // Stats are sent to other servers, so they must outlive the query text they were gathered for.
+    void TestCollectionStatsOwnWords() {
+        SearchServer first_server(""s);
+        first_server.AddDocument(1, "fluffy cat fluffy tail"sv, DocumentStatus::ACTUAL, { 7 });
+        first_server.AddDocument(2, "cat in cage"sv, DocumentStatus::ACTUAL, { 2 });
+        const CollectionStats collection_stats = GetCollectionStatsOfDestroyedQuery(first_server);
+        // likely takes over the buffer of the destroyed query
+        const string overwritten_query(40, 'x');
+
+        map<string, int, less<>> expected_document_freqs = { { "a"s, 0 }, { "cat"s, 2 }, { "fluffy"s, 1 }, { "long"s, 0 }, { "tail"s, 1 }, { "with"s, 0 } };
+        ASSERT(collection_stats.document_count == 2);
+        ASSERT(collection_stats.document_freqs == expected_document_freqs);
+        ASSERT(overwritten_query.size() == 40);
+
+        SearchServer second_server(""s);
+        second_server.AddDocument(3, "white cat"sv, DocumentStatus::ACTUAL, { 1 });
+        const vector<Document> documents = second_server.FindTopDocuments("fluffy cat with a long tail -collar"sv, DocumentStatus::ACTUAL, collection_stats);
+        ASSERT(documents.size() == 1 && documents[0].id == 3);
+    }
+
+    constexpr array<string_view, 3> TEST_STOP_WORDS = { "and"sv, "in"sv, "on"sv };
+    constexpr auto TEST_STOP_WORD_TABLE = MakeFlatStringTable(TEST_STOP_WORDS);
+    using StopWordTable = remove_const_t<decltype(TEST_STOP_WORD_TABLE)>;
+
+    // servers keep a reference to a stop-word table, so they must not accept a temporary one
+    static_assert(is_constructible_v<SearchServer, const StopWordTable&>);
+    static_assert(!is_constructible_v<SearchServer, StopWordTable>);
+    static_assert(!is_constructible_v<SearchServer, const StopWordTable>);
+    static_assert(is_constructible_v<FlatStringSet, const StopWordTable&>);
+    static_assert(!is_constructible_v<FlatStringSet, StopWordTable>);
+    static_assert(is_constructible_v<ShardedSearchServer, size_t, const StopWordTable&>);
+    static_assert(!is_constructible_v<ShardedSearchServer, size_t, StopWordTable>);
+
+    void TestStopWordTableLookup() {
+        SearchServer table_server(TEST_STOP_WORD_TABLE);
+        SearchServer text_server("and in on"s);
+        for (SearchServer* search_server : { &table_server, &text_server }) {
+            search_server->AddDocument(1, "cat in the city and"sv, DocumentStatus::ACTUAL, { 1 });
+            search_server->AddDocument(2, "dog on street"sv, DocumentStatus::ACTUAL, { 2 });
+            ASSERT(search_server->FindTopDocuments("in on"sv).empty());
+            ASSERT(GetMatchedWords(*search_server, "cat and city"sv, 1) == vector<string_view>({ "cat"sv, "city"sv }));
+        }
+        ShardedSearchServer sharded_server(3, TEST_STOP_WORD_TABLE);
+        sharded_server.AddDocument(1, "cat in the city"sv, DocumentStatus::ACTUAL, { 1 });
+        ASSERT(sharded_server.FindTopDocuments("in"sv).empty() && sharded_server.FindTopDocuments("cat"sv).size() == 1);
+
+        const FlatStringSet moved_set(FlatStringSet(vector<string>{ "ab"s, "ab"s, ""s, "c"s }));
+        ASSERT(moved_set.Contains("ab"sv) && moved_set.Contains("c"sv) && !moved_set.Contains(""sv) && !moved_set.Contains("a"sv));
+        try {
+            SearchServer search_server("a\x01 b"s);
+            ASSERT(false);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+
+    size_t GetResidentSetKilobytes() {
+        ifstream status("/proc/self/status"s);
+        string line;
+        while (getline(status, line)) {
+            if (line.rfind("VmRSS:"s, 0) == 0) {
+                return stoul(line.substr(6));
+            }
+        }
+        return 0;
+    }
+
+    void PrintAllocationStats(const string& name, const AllocationStats& stats) {
+        cerr << name << ": "s << stats.allocation_count << " allocations, "s << stats.allocated_bytes / 1024 << " KB allocated, "s
+            << stats.bytes_in_use / 1024 << " KB in use, "s << stats.peak_bytes_in_use / 1024 << " KB at peak"s << endl;
+    }
+
+    void BenchmarkMemoryResource(const string& name, pmr::memory_resource* memory_resource,
+        const vector<string>& documents, const vector<string>& queries) {
+        const size_t rss_before = GetResidentSetKilobytes();
+        SearchServer search_server(""s, memory_resource);
+        {
+            LOG_DURATION_STREAM(name + ", AddDocument"s, cerr);
+            AddDocuments(search_server, documents);
+        }
+        cerr << name << ", RSS growth: "s << GetResidentSetKilobytes() - rss_before << " KB"s << endl;
+        {
+            LOG_DURATION_STREAM(name + ", FindTopDocuments"s, cerr);
+            for (const string& query : queries) {
+                search_server.FindTopDocuments(query);
+            }
+        }
+        PrintAllocationStats(name + ", index"s, search_server.GetIndexAllocationStats());
+        PrintAllocationStats(name + ", query scratch overflow"s, search_server.GetQueryAllocationStats());
+    }
+
+    constexpr array<string_view, 32> ENGLISH_STOP_WORDS = {
+        "a"sv, "an"sv, "and"sv, "are"sv, "as"sv, "at"sv, "be"sv, "but"sv, "by"sv, "for"sv, "from"sv,
+        "has"sv, "he"sv, "in"sv, "is"sv, "it"sv, "its"sv, "of"sv, "on"sv, "or"sv, "she"sv, "that"sv,
+        "the"sv, "their"sv, "they"sv, "this"sv, "to"sv, "was"sv, "were"sv, "will"sv, "with"sv, "you"sv
+    };
+    constexpr auto ENGLISH_STOP_WORD_TABLE = MakeFlatStringTable(ENGLISH_STOP_WORDS);
+
+    template <typename Predicate>
+    void BenchmarkStopWordSet(const string& name, const vector<string_view>& tokens, int pass_count, Predicate is_stop_word) {
+        using namespace chrono;
+        size_t stop_word_count = 0;
+        const auto start_time = LogDuration::Clock::now();
+        for (int pass = 0; pass < pass_count; ++pass) {
+            for (const string_view token : tokens) {
+                stop_word_count += is_stop_word(token);
+            }
+        }
+        const auto duration = LogDuration::Clock::now() - start_time;
+        const double nanoseconds_per_token = static_cast<double>(duration_cast<nanoseconds>(duration).count()) / (tokens.size() * pass_count);
+        cerr << name << ": "s << nanoseconds_per_token << " ns per token, "s << stop_word_count / pass_count << " stop words"s << endl;
+    }
+}
+
+void BenchmarkRemoveDocuments() {
+    mt19937 generator;
+    const vector<string> dictionary = GenerateDictionary(generator, 10'000, 10);
+    const vector<string> documents = GenerateDocuments(generator, dictionary, 1'000'000, 8);
+
+    vector<int> removed_ids(documents.size());
+    iota(removed_ids.begin(), removed_ids.end(), 0);
+    shuffle(removed_ids.begin(), removed_ids.end(), generator);
+    removed_ids.resize(removed_ids.size() / 10);
+
+    {
+        SearchServer search_server(""s);
+        AddDocuments(search_server, documents);
+        LOG_DURATION_STREAM("RemoveDocument, one by one"s, cerr);
+        for (const int document_id : removed_ids) {
+            search_server.RemoveDocument(document_id);
+        }
+    }
+    {
+        SearchServer search_server(""s);
+        AddDocuments(search_server, documents);
+        LOG_DURATION_STREAM("RemoveDocuments, seq"s, cerr);
+        search_server.RemoveDocuments(execution::seq, removed_ids);
+    }
+    {
+        SearchServer search_server(""s);
+        AddDocuments(search_server, documents);
+        LOG_DURATION_STREAM("RemoveDocuments, par"s, cerr);
+        search_server.RemoveDocuments(execution::par, removed_ids);
+    }
+}
+
+void BenchmarkMemoryResources() {
+    mt19937 generator;
+    const vector<string> dictionary = GenerateDictionary(generator, 10'000, 10);
+    const vector<string> documents = GenerateDocuments(generator, dictionary, 200'000, 8);
+    vector<string> queries;
+    for (int i = 0; i < 10'000; ++i) {
+        queries.push_back(GenerateText(generator, dictionary, 3));
+    }
+
+    BenchmarkMemoryResource("default resource"s, pmr::get_default_resource(), documents, queries);
+    {
+        pmr::unsynchronized_pool_resource pool;
+        BenchmarkMemoryResource("pool resource"s, &pool, documents, queries);
+    }
+    {
+        pmr::monotonic_buffer_resource arena;
+        BenchmarkMemoryResource("monotonic resource"s, &arena, documents, queries);
+    }
+}
+
+void BenchmarkStopWordLookup() {
+    mt19937 generator;
+    vector<string> dictionary = GenerateDictionary(generator, 10'000, 10);
+    // About a third of the tokens in a natural text are stop words
+    for (int i = 0; i < 150; ++i) {
+        dictionary.insert(dictionary.end(), ENGLISH_STOP_WORDS.begin(), ENGLISH_STOP_WORDS.end());
+    }
+    const string text = GenerateText(generator, dictionary, 1'000'000);
+    const vector<string_view> tokens = SplitIntoWords(text);
+    const int pass_count = 10;
+
+    const set<string, less<>> tree_set(ENGLISH_STOP_WORDS.begin(), ENGLISH_STOP_WORDS.end());
+    BenchmarkStopWordSet("std::set"s, tokens, pass_count, [&tree_set](string_view token) {
+        return tree_set.count(token) > 0;
+        });
+    const FlatStringSet runtime_set(ENGLISH_STOP_WORDS);
+    BenchmarkStopWordSet("FlatStringSet, built at run time"s, tokens, pass_count, [&runtime_set](string_view token) {
+        return runtime_set.Contains(token);
+        });
+    const FlatStringSet static_set(ENGLISH_STOP_WORD_TABLE);
+    BenchmarkStopWordSet("FlatStringSet, constexpr table"s, tokens, pass_count, [&static_set](string_view token) {
+        return static_set.Contains(token);
+        });
+}
+
+void TestSearchServer() {
+    TestFindTopDocumentsByRatingRange();
+    TestMatchDocuments();
+    TestRemoveDocumentsWithCompaction();
+    TestRemoveDocumentsMatchesRebuiltServer();
+    TestImpactScoringClearsCounters();
+    TestShardedSearchServerMatchesSingleServer();
+    TestFindTopDocumentsRejectsInvalidCollectionStats();
+    TestCollectionStatsOwnWords();
+    TestStopWordTableLookup();
+    cerr << "Search server tests passed"s << endl;
+}
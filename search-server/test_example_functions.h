@@ -1 +1,8 @@
 #pragma once
+#include "search_server.h"
+
+void TestSearchServer();
+
+void BenchmarkRemoveDocuments();
+void BenchmarkMemoryResources();
+void BenchmarkStopWordLookup();